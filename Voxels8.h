@@ -56,6 +56,23 @@ public:
         voxels[x * (rows * cols) + y * cols + z] = value > 0;
     }
 
+    unsigned char get(unsigned int x, unsigned int y, unsigned int z) const {
+        return voxels[x * (rows * cols) + y * cols + z];
+    }
+
+    /** Call visit(x, y, z) for every set voxel */
+    template <typename Visitor>
+    void forEachSet(Visitor visit) const {
+        for (unsigned int x = 0; x < cols; x++) {
+            for (unsigned int y = 0; y < rows; y++) {
+                for (unsigned int z = 0; z < planes; z++) {
+                    if (voxels[x * (rows * cols) + y * cols + z] != 0)
+                        visit(x, y, z);
+                }
+            }
+        }
+    }
+
     void subtract(const Voxels8& other) {
         unsigned char* v0 = voxels;
         unsigned char* v1 = other.voxels;
@@ -127,6 +144,36 @@ public:
         return true;
     }
 
+    /** Resample other rotated about (cx, cy, cz) and AND it with this volume into result.
+     *  Voxel p of result is this(p) & other(rotation * (p - c) + c), sampled nearest neighbour. */
+    void rotatedGridAND(const Voxels8& other, unsigned int cx, unsigned int cy, unsigned int cz,
+                        const double rotation[3][3], Voxels8 *result) const {
+
+        for (unsigned int x = 0; x < cols; x++) {
+            for (unsigned int y = 0; y < rows; y++) {
+                for (unsigned int z = 0; z < planes; z++) {
+                    unsigned int index = x * (rows * cols) + y * cols + z;
+                    unsigned char value = 0;
+                    if (voxels[index] != 0) {
+                        double px = (double) x - cx;
+                        double py = (double) y - cy;
+                        double pz = (double) z - cz;
+                        double sx = rotation[0][0] * px + rotation[0][1] * py + rotation[0][2] * pz + cx + 0.5;
+                        double sy = rotation[1][0] * px + rotation[1][1] * py + rotation[1][2] * pz + cy + 0.5;
+                        double sz = rotation[2][0] * px + rotation[2][1] * py + rotation[2][2] * pz + cz + 0.5;
+                        if (sx >= 0 && sx < other.cols && sy >= 0 && sy < other.rows && sz >= 0 && sz < other.planes) {
+                            unsigned int ix = (unsigned int) sx;
+                            unsigned int iy = (unsigned int) sy;
+                            unsigned int iz = (unsigned int) sz;
+                            value = other.voxels[ix * (other.rows * other.cols) + iy * other.cols + iz] > 0;
+                        }
+                    }
+                    result->voxels[index] = value;
+                }
+            }
+        }
+    }
+
     void getBoundingRangeAndCount() {
         gotRange = true;
         maxx = 0;
@@ -5,12 +5,19 @@
 #ifndef VOXELS_VOXELSPACKED_H
 #define VOXELS_VOXELSPACKED_H
 
+#include <cmath>
+#include <thread>
+#include <vector>
+
 class VoxelsPacked {
+public:
+    typedef unsigned long WORD;
+
+private:
     unsigned int rows, cols, planes;
     unsigned int planes32;
     unsigned int size;
     unsigned int words_per_plane;
-    typedef unsigned long WORD;
     unsigned int bits_per_word;
     WORD *voxels;
     bool gotRange;
@@ -68,7 +75,7 @@ public:
         return count;
     }
 
-    unsigned int get_index(unsigned int x, unsigned int y, unsigned int z) {
+    unsigned int get_index(unsigned int x, unsigned int y, unsigned int z) const {
         return (x * words_per_plane * rows) + (y * words_per_plane) + (z / bits_per_word);
     }
 
@@ -83,6 +90,82 @@ public:
         *v = new_value;
     }
 
+    unsigned char get(unsigned int x, unsigned int y, unsigned int z) const {
+        WORD word = voxels[get_index(x, y, z)];
+        return (unsigned char) ((word >> ((bits_per_word - 1) - (z % bits_per_word))) & (WORD) 1);
+    }
+
+    /** Read n voxels whose coordinates are packed as x, y, z triples in xyz */
+    void get(const unsigned int *xyz, unsigned int n, unsigned char *values) const {
+        for (unsigned int i = 0; i < n; i++) {
+            values[i] = get(xyz[0], xyz[1], xyz[2]);
+            xyz += 3;
+        }
+    }
+
+    /** Write value to n voxels whose coordinates are packed as x, y, z triples in xyz */
+    void set(const unsigned int *xyz, unsigned int n, unsigned char value) {
+        for (unsigned int i = 0; i < n; i++) {
+            WORD mask = 1UL << ((bits_per_word - 1) - (xyz[2] % bits_per_word));
+            WORD* v = voxels + get_index(xyz[0], xyz[1], xyz[2]);
+            if (value > 0)
+                *v |= mask;
+            else
+                *v &= ~mask;
+            xyz += 3;
+        }
+    }
+
+    unsigned int wordsPerScanline() const {
+        return words_per_plane;
+    }
+
+    /** The wordsPerScanline() words holding voxels (x, y, 0 .. planes - 1); z is stored high bit first */
+    WORD *scanline(unsigned int x, unsigned int y) {
+        return voxels + get_index(x, y, 0);
+    }
+
+    const WORD *scanline(unsigned int x, unsigned int y) const {
+        return voxels + get_index(x, y, 0);
+    }
+
+    /** The words of scanline (x, y) covering z_begin up to but not including z_end; *first_word receives the
+     *  index within the scanline of the first returned word and *words the number of words */
+    WORD *span(unsigned int x, unsigned int y, unsigned int z_begin, unsigned int z_end,
+               unsigned int *first_word, unsigned int *words) {
+        *first_word = z_begin / bits_per_word;
+        *words = z_end > z_begin ? (z_end + bits_per_word - 1) / bits_per_word - *first_word : 0;
+        return voxels + get_index(x, y, z_begin);
+    }
+
+    const WORD *span(unsigned int x, unsigned int y, unsigned int z_begin, unsigned int z_end,
+                     unsigned int *first_word, unsigned int *words) const {
+        *first_word = z_begin / bits_per_word;
+        *words = z_end > z_begin ? (z_end + bits_per_word - 1) / bits_per_word - *first_word : 0;
+        return voxels + get_index(x, y, z_begin);
+    }
+
+    /** Call visit(x, y, z) for every set voxel in memory order, skipping empty words and jumping between set bits */
+    template <typename Visitor>
+    void forEachSet(Visitor visit) const {
+        const WORD* v = voxels;
+
+        for (unsigned int x = 0; x < cols; x++) {
+            for (unsigned int y = 0; y < rows; y++) {
+                for (unsigned int z = 0; z < words_per_plane; z++) {
+                    WORD data1 = *v;
+                    while (data1 != 0) {
+                        // z is packed high bit first, so the lowest z is the leading set bit
+                        unsigned int i = (unsigned int) __builtin_clzl(data1);
+                        visit(x, y, z * bits_per_word + i);
+                        data1 &= ~((WORD) 0x8000000000000000ul >> i);
+                    }
+                    v++;
+                }
+            }
+        }
+    }
+
     void getBoundingRangeAndCount() {
         WORD* v = voxels;
 
@@ -162,6 +245,62 @@ public:
         return true;
     }
 
+    /** Build the rotation matrix Rz * Ry * Rx for the given angles in radians */
+    static void rotationMatrix(double angleX, double angleY, double angleZ, double rotation[3][3]) {
+        double ca = cos(angleX), sa = sin(angleX);
+        double cb = cos(angleY), sb = sin(angleY);
+        double cc = cos(angleZ), sc = sin(angleZ);
+
+        rotation[0][0] = cc * cb;
+        rotation[0][1] = cc * sb * sa - sc * ca;
+        rotation[0][2] = cc * sb * ca + sc * sa;
+        rotation[1][0] = sc * cb;
+        rotation[1][1] = sc * sb * sa + cc * ca;
+        rotation[1][2] = sc * sb * ca - cc * sa;
+        rotation[2][0] = -sb;
+        rotation[2][1] = cb * sa;
+        rotation[2][2] = cb * ca;
+    }
+
+    /** Resample other rotated about (cx, cy, cz) and AND it with this volume into result, which must be the
+     *  same size as this volume. Voxel p of result is this(p) & other(rotation * (p - c) + c), sampled nearest
+     *  neighbour; samples falling outside other are empty. */
+    void rotatedGridAND(const VoxelsPacked& other, unsigned int cx, unsigned int cy, unsigned int cz,
+                        const double rotation[3][3], VoxelsPacked *result) const {
+        rotatedGridANDSlices(other, cx, cy, cz, rotation, result, 0, cols);
+    }
+
+    void rotatedGridAND(const VoxelsPacked& other, unsigned int cx, unsigned int cy, unsigned int cz,
+                        double angleX, double angleY, double angleZ, VoxelsPacked *result) const {
+        double rotation[3][3];
+        rotationMatrix(angleX, angleY, angleZ, rotation);
+        rotatedGridANDSlices(other, cx, cy, cz, rotation, result, 0, cols);
+    }
+
+    /** As rotatedGridAND, splitting the x slices across threads (0 = one per hardware thread) */
+    void rotatedGridANDParallel(const VoxelsPacked& other, unsigned int cx, unsigned int cy, unsigned int cz,
+                                const double rotation[3][3], VoxelsPacked *result, unsigned int threads = 0) const {
+        if (threads == 0)
+            threads = std::thread::hardware_concurrency();
+        if (threads == 0)
+            threads = 1;
+        if (threads > cols)
+            threads = cols;
+
+        std::vector<std::thread> workers;
+        unsigned int x_begin = 0;
+        for (unsigned int t = 0; t < threads; t++) {
+            unsigned int x_end = x_begin + (cols - x_begin) / (threads - t);
+            workers.push_back(std::thread([=, &other] {
+                rotatedGridANDSlices(other, cx, cy, cz, rotation, result, x_begin, x_end);
+            }));
+            x_begin = x_end;
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
     VoxelsPacked *dilate(unsigned char region) {
 
         auto *rtv = new VoxelsPacked(rows, cols, planes);
@@ -220,6 +359,66 @@ public:
 
         return rtv;
     }
+
+private:
+
+    void rotatedGridANDSlices(const VoxelsPacked& other, unsigned int cx, unsigned int cy, unsigned int cz,
+                              const double rotation[3][3], VoxelsPacked *result,
+                              unsigned int x_begin, unsigned int x_end) const {
+        // source step for one voxel along the scanline (z), and for one word of it
+        const double dx = rotation[0][2];
+        const double dy = rotation[1][2];
+        const double dz = rotation[2][2];
+        const double word_dx = dx * bits_per_word;
+        const double word_dy = dy * bits_per_word;
+        const double word_dz = dz * bits_per_word;
+        const double other_cols = other.cols;
+        const double other_rows = other.rows;
+        const double other_planes = other.planes;
+
+        for (unsigned int x = x_begin; x < x_end; x++) {
+            for (unsigned int y = 0; y < rows; y++) {
+                const WORD *v = voxels + get_index(x, y, 0);
+                WORD *v2 = result->voxels + get_index(x, y, 0);
+
+                // source of (x, y, 0); biased by 0.5 so truncating a non-negative coordinate rounds to nearest
+                double px = (double) x - cx;
+                double py = (double) y - cy;
+                double pz = -(double) cz;
+                double sx = rotation[0][0] * px + rotation[0][1] * py + rotation[0][2] * pz + cx + 0.5;
+                double sy = rotation[1][0] * px + rotation[1][1] * py + rotation[1][2] * pz + cy + 0.5;
+                double sz = rotation[2][0] * px + rotation[2][1] * py + rotation[2][2] * pz + cz + 0.5;
+
+                for (unsigned int z = 0; z < words_per_plane; z++) {
+                    WORD value = *v;
+                    if (value != 0) {
+                        WORD gathered = 0;
+                        double tx = sx;
+                        double ty = sy;
+                        double tz = sz;
+                        for (unsigned int i = 0; i < bits_per_word; i++) {
+                            if (tx >= 0 && tx < other_cols && ty >= 0 && ty < other_rows && tz >= 0 && tz < other_planes) {
+                                unsigned int ix = (unsigned int) tx;
+                                unsigned int iy = (unsigned int) ty;
+                                unsigned int iz = (unsigned int) tz;
+                                gathered |= (WORD) other.get(ix, iy, iz) << ((bits_per_word - 1) - i);
+                            }
+                            tx += dx;
+                            ty += dy;
+                            tz += dz;
+                        }
+                        value &= gathered;
+                    }
+                    *v2 = value;
+                    sx += word_dx;
+                    sy += word_dy;
+                    sz += word_dz;
+                    v++;
+                    v2++;
+                }
+            }
+        }
+    }
 };
 
 #endif //VOXELS_VOXELSPACKED_H
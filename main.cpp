@@ -106,6 +106,97 @@ double TestVoxelsPacked_GetBoundingRangeAndCount(int size, int iterations) {
 }
 
 
+template <typename T>
+void FillBall(T& volume, int size) {
+    int c = size / 2;
+    int r = size / 3;
+    for (int x = 0; x < size; x++)
+        for (int y = 0; y < size; y++)
+            for (int z = 0; z < size; z++)
+                if ((x - c) * (x - c) + (y - c) * (y - c) + (z - c) * (z - c) <= r * r)
+                    volume.set(x, y, z, 1);
+}
+
+double TestVoxels8_RotatedGridAND(int size, int iterations) {
+    Voxels8 a(size, size, size);
+    Voxels8 b(size, size, size);
+    Voxels8 result(size, size, size);
+    double rotation[3][3];
+    VoxelsPacked::rotationMatrix(0.3, 0.2, 0.1, rotation);
+    FillBall(a, size);
+    FillBall(b, size);
+    Timer timer;
+
+    for (int i=0; i< iterations; i++) {
+        a.rotatedGridAND(b, size / 2, size / 2, size / 2, rotation, &result);
+    }
+    return timer.elapsed();
+}
+
+double TestVoxelsPacked_RotatedGridAND(int size, int iterations) {
+    VoxelsPacked a(size, size, size);
+    VoxelsPacked b(size, size, size);
+    VoxelsPacked result(size, size, size);
+    double rotation[3][3];
+    VoxelsPacked::rotationMatrix(0.3, 0.2, 0.1, rotation);
+    FillBall(a, size);
+    FillBall(b, size);
+    Timer timer;
+
+    for (int i=0; i< iterations; i++) {
+        a.rotatedGridAND(b, size / 2, size / 2, size / 2, rotation, &result);
+    }
+    return timer.elapsed();
+}
+
+double TestVoxelsPacked_RotatedGridANDParallel(int size, int iterations) {
+    VoxelsPacked a(size, size, size);
+    VoxelsPacked b(size, size, size);
+    VoxelsPacked result(size, size, size);
+    double rotation[3][3];
+    VoxelsPacked::rotationMatrix(0.3, 0.2, 0.1, rotation);
+    FillBall(a, size);
+    FillBall(b, size);
+    Timer timer;
+
+    for (int i=0; i< iterations; i++) {
+        a.rotatedGridANDParallel(b, size / 2, size / 2, size / 2, rotation, &result);
+    }
+    return timer.elapsed();
+}
+
+
+double TestVoxels8_ForEachSet(int size, int iterations) {
+    Voxels8 a(size, size, size);
+    FillBall(a, size);
+    unsigned long sum = 0;
+    Timer timer;
+
+    for (int i=0; i< iterations; i++) {
+        a.forEachSet([&sum](unsigned int x, unsigned int y, unsigned int z) { sum += x + y + z; });
+    }
+    double elapsed = timer.elapsed();
+    if (sum == 0)
+        std::cout << "empty" << std::endl;
+    return elapsed;
+}
+
+double TestVoxelsPacked_ForEachSet(int size, int iterations) {
+    VoxelsPacked a(size, size, size);
+    FillBall(a, size);
+    unsigned long sum = 0;
+    Timer timer;
+
+    for (int i=0; i< iterations; i++) {
+        a.forEachSet([&sum](unsigned int x, unsigned int y, unsigned int z) { sum += x + y + z; });
+    }
+    double elapsed = timer.elapsed();
+    if (sum == 0)
+        std::cout << "empty" << std::endl;
+    return elapsed;
+}
+
+
 void run_test(const std::string message, double (*func1)(int, int), double (*func2)(int, int), int size, int iterations) {
     double voxels_8 = func1(size, iterations);
     double voxels_long = func2(size, iterations);
@@ -134,12 +225,41 @@ int main() {
         std::cout << "VoxelsPacked bytes: " << voxels_packed.bytes() << std::endl;
         std::cout << "TestVoxelsPacked bits per word: " << voxels_packed.bitsPerWord() << std::endl;
 
+        double rotation[3][3];
+        VoxelsPacked::rotationMatrix(0.3, 0.2, 0.1, rotation);
+        Voxels8 rotated_8(size, size, size);
+        VoxelsPacked rotated_packed(size, size, size);
+        FillBall(voxels_8, size);
+        FillBall(voxels_packed, size);
+        voxels_8.rotatedGridAND(voxels_8, size / 2, size / 2, size / 2, rotation, &rotated_8);
+        voxels_packed.rotatedGridAND(voxels_packed, size / 2, size / 2, size / 2, rotation, &rotated_packed);
+        std::cout << "TestVoxels8 rotated AND: " << rotated_8.getCount() << std::endl;
+        std::cout << "TestVoxelsPacked rotated AND: " << rotated_packed.getCount() << std::endl;
+
+        unsigned int visited = 0;
+        rotated_packed.forEachSet([&](unsigned int x, unsigned int y, unsigned int z) {
+            if (rotated_packed.get(x, y, z) && rotated_8.get(x, y, z))
+                visited++;
+        });
+        std::cout << "TestVoxelsPacked forEachSet visited: " << visited << std::endl;
+
+        unsigned int xyz[] = {1, 1, 1, 2, 3, 63, 0, 0, 0};
+        unsigned char values[3];
+        VoxelsPacked batch(size, size, size);
+        batch.set(xyz, 2, 1);
+        batch.get(xyz, 3, values);
+        std::cout << "TestVoxelsPacked batch get: " << (int) values[0] << (int) values[1] << (int) values[2]
+                  << " count " << batch.getCount() << std::endl;
+
     }
 
     run_test("SUBTRACT", TestVoxels8_Subtract, TestVoxelsPacked_Subtract, size, iterations);
     run_test("DILATE", TestVoxels8_Dilate, TestVoxelsPacked_Dilate, size, iterations);
     run_test("ISEQUAL", TestVoxels8_IsEqual, TestVoxelsPacked_IsEqual, size, iterations);
     run_test("GETBOUNDINGRANGEANDCOUNT", TestVoxels8_GetBoundingRangeAndCount, TestVoxelsPacked_GetBoundingRangeAndCount, size, iterations);
+    run_test("ROTATEDGRIDAND", TestVoxels8_RotatedGridAND, TestVoxelsPacked_RotatedGridAND, size, iterations);
+    run_test("ROTATEDGRIDAND PARALLEL", TestVoxels8_RotatedGridAND, TestVoxelsPacked_RotatedGridANDParallel, size, iterations);
+    run_test("FOREACHSET", TestVoxels8_ForEachSet, TestVoxelsPacked_ForEachSet, size, iterations);
 
     return 0;
 }